@@ -1,8 +1,17 @@
 #define _GNU_SOURCE
 #include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
 #include <vigor.h>
+#include <signal.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 
 #include <SDL.h>
 #include <SDL_image.h>
@@ -10,6 +19,28 @@
 
 #define TITLE_FONT_SIZE 48
 
+/* all of the art (and the layout numbers in .index files)
+   are authored against this viewport size; other resolutions
+   get everything scaled up (or down) from here. */
+#define NATIVE_WIDTH  1280
+#define NATIVE_HEIGHT 768
+
+/* where to keep the session snapshot (selection + last frame)
+   that lets us put a picture up immediately at power-on */
+#define SESSION_FILE  "/var/tmp/arcade.session"
+#define SESSION_MAGIC "ARCSESS1"
+
+/* runtime counters get dumped here (as JSON) on SIGUSR1,
+   and served to anyone who connects to the socket */
+#define STATS_FILE    "/var/tmp/arcade.stats.json"
+#define STATS_SOCKET  "/var/tmp/arcade.sock"
+#define HUD_FONT_SIZE 16
+#define FRAME_SAMPLES 256
+
+/* lossy 8-bit palettes that come out any worse than this
+   (peak signal-to-noise, in dB) keep their art true-color */
+#define ART_MIN_PSNR  38.0
+
 typedef struct {
 	char  *path;
 	char  *exec;
@@ -43,12 +74,43 @@ typedef struct {
 	title_t **titles;
 
 	SDL_Surface *viewport;
+	double scale; /* viewport size / native size */
 	SDL_Rect box_rect, inset_rect;
 	SDL_Surface *box;
 	SDL_Surface *overlay;
 	TTF_Font    *font;
+	TTF_Font    *hud;  /* stats overlay font; NULL unless ARCADE_HUD is set */
+	int          compact; /* store art paletted / RLE where it pays; ARCADE_ART=raw turns it off */
+
+	uint64_t fingerprint; /* of the catalog this grid was built from */
 } title_grid_t;
 
+typedef struct {
+	SDL_Surface *surface;
+	size_t       bytes;   /* resident pixel data, including palette (estimated, once RLE'd) */
+} art_t;
+
+static struct {
+	double boot;        /* when main() started; everything else is relative */
+	double first_pixel; /* something (snapshot or real grid) was on screen */
+	double interactive; /* the real grid was on screen */
+	double load_ms;     /* spent in grid_create() */
+
+	unsigned long frames;
+	double last_frame;
+	double frame_ms[FRAME_SAMPLES]; /* ring of recent frame times */
+
+	unsigned long launches;
+	double last_launch_ms, total_launch_ms;
+	int    last_status;
+
+	art_t  *art;        /* every piece of decoded art we're holding on to */
+	int     surfaces, art_cap;
+	size_t  art_bytes;
+} stats;
+
+static volatile sig_atomic_t stats_requested = 0;
+
 SDL_Surface* load_png(const char *path, SDL_Surface *optimize_for)
 {
 	SDL_Surface *raw = IMG_Load(path);
@@ -60,7 +122,535 @@ SDL_Surface* load_png(const char *path, SDL_Surface *optimize_for)
 	return opt;
 }
 
-title_t* title_read_from_metadata(const char *root, const char *dir)
+double now_ms(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static size_t surface_bytes(SDL_Surface *s)
+{
+	return s->h * s->pitch
+		+ (s->format->palette ? s->format->palette->ncolors * sizeof(SDL_Color) : 0);
+}
+
+/* keep track of decoded art, so we know how much of it is resident */
+SDL_Surface* track_art_as(SDL_Surface *s, size_t bytes)
+{
+	if (!s)
+		return NULL;
+
+	if (stats.surfaces == stats.art_cap) {
+		stats.art_cap = stats.art_cap ? stats.art_cap * 2 : 64;
+		stats.art = realloc(stats.art, stats.art_cap * sizeof(art_t));
+		if (!stats.art) {
+			perror("track_art");
+			exit(1);
+		}
+	}
+	stats.art[stats.surfaces].surface = s;
+	stats.art[stats.surfaces].bytes   = bytes;
+	stats.art_bytes += bytes;
+	stats.surfaces++;
+	return s;
+}
+
+SDL_Surface* track_art(SDL_Surface *s)
+{
+	return s ? track_art_as(s, surface_bytes(s)) : NULL;
+}
+
+void free_art(SDL_Surface *s)
+{
+	int i;
+	for (i = 0; s && i < stats.surfaces; i++) {
+		if (stats.art[i].surface != s)
+			continue;
+		stats.art_bytes -= stats.art[i].bytes;
+		stats.art[i] = stats.art[--stats.surfaces];
+		break;
+	}
+	SDL_FreeSurface(s);
+}
+
+/* blend two 32-bit pixels, channel by channel; t runs from 0 (all a)
+   to 256 (all b).  we never care which byte is which channel, so this
+   works for any 32-bit pixel format. */
+static Uint32 lerp32(Uint32 a, Uint32 b, unsigned int t)
+{
+	Uint32 rb = ((a & 0x00ff00ff) * (256 - t) + (b & 0x00ff00ff) * t) >> 8;
+	Uint32 ag = (((a >> 8) & 0x00ff00ff) * (256 - t) + ((b >> 8) & 0x00ff00ff) * t) >> 8;
+	return (rb & 0x00ff00ff) | ((ag & 0x00ff00ff) << 8);
+}
+
+static SDL_Surface* surface_like(SDL_Surface *src, int w, int h)
+{
+	SDL_Surface *dst = SDL_CreateRGBSurface(SDL_SWSURFACE | (src->flags & SDL_SRCALPHA), w, h, 32,
+		src->format->Rmask, src->format->Gmask, src->format->Bmask, src->format->Amask);
+	if (dst && (src->flags & SDL_SRCCOLORKEY))
+		SDL_SetColorKey(dst, SDL_SRCCOLORKEY, src->format->colorkey);
+	return dst;
+}
+
+/* scale the color channels of every pixel by its alpha (or, with undo,
+   back again), so that filtering doesn't drag the color of transparent
+   pixels into the edges of the opaque ones next to them. */
+static void premultiply(SDL_Surface *s, int undo)
+{
+	int x, y, shift;
+	SDL_LockSurface(s);
+	for (y = 0; y < s->h; y++) {
+		Uint32 *row = (Uint32 *)((Uint8 *)s->pixels + y * s->pitch);
+		for (x = 0; x < s->w; x++) {
+			Uint32 a = (row[x] & s->format->Amask) >> s->format->Ashift;
+			Uint32 p = row[x] & s->format->Amask;
+			if (undo && a == 0) {
+				row[x] = 0;
+				continue;
+			}
+			for (shift = 0; shift < 32; shift += 8) {
+				Uint32 c = (row[x] >> shift) & 0xff;
+				if (shift == s->format->Ashift)
+					continue;
+				c = undo ? (c * 255 + a / 2) / a : (c * a + 127) / 255;
+				p |= (c > 255 ? 255 : c) << shift;
+			}
+			row[x] = p;
+		}
+	}
+	SDL_UnlockSurface(s);
+}
+
+/* src at 32 bits per pixel: src itself if it already is, otherwise a
+   converted copy (src is left alone either way).
+
+   with unkey, a color key is turned into an alpha channel instead (key
+   pixels fully transparent, everything else opaque), for callers that
+   blend pixels together and can't have the key color bleeding in. */
+static SDL_Surface* surface_32bpp(SDL_Surface *src, int unkey)
+{
+	unkey = unkey && (src->flags & SDL_SRCCOLORKEY);
+	if (src->format->BytesPerPixel == 4 && !unkey)
+		return src;
+
+	/* only keep an alpha channel if there was one to begin with (or we
+	   are making one out of the key); opaque art shouldn't pay for
+	   per-pixel alpha blending */
+	SDL_Surface *tmp = SDL_CreateRGBSurface(SDL_SWSURFACE, 1, 1, 32,
+		0x000000ff, 0x0000ff00, 0x00ff0000, src->format->Amask || unkey ? 0xff000000 : 0);
+
+	/* converting to a format with alpha without asking to keep the key
+	   blits through it, so key pixels stay clear (as in SDL_DisplayFormatAlpha) */
+	Uint32 flags = unkey ? SDL_SRCALPHA : src->flags & (SDL_SRCALPHA | SDL_SRCCOLORKEY);
+	SDL_Surface *dst = tmp ? SDL_ConvertSurface(src, tmp->format, SDL_SWSURFACE | flags) : NULL;
+	SDL_FreeSurface(tmp);
+	return dst;
+}
+
+/* generate the next mip level down from src: half the size,
+   with every pixel the average of the 2x2 block it came from. */
+static SDL_Surface* mip_halve(SDL_Surface *src)
+{
+	SDL_Surface *dst = surface_like(src, src->w / 2, src->h / 2);
+	if (!dst)
+		return NULL;
+
+	SDL_LockSurface(src);
+	SDL_LockSurface(dst);
+	int x, y;
+	for (y = 0; y < dst->h; y++) {
+		Uint32 *a = (Uint32 *)((Uint8 *)src->pixels + (2 * y)     * src->pitch);
+		Uint32 *b = (Uint32 *)((Uint8 *)src->pixels + (2 * y + 1) * src->pitch);
+		Uint32 *to = (Uint32 *)((Uint8 *)dst->pixels + y * dst->pitch);
+
+		for (x = 0; x < dst->w; x++, a += 2, b += 2) {
+			Uint32 rb = ((a[0] & 0x00ff00ff) + (a[1] & 0x00ff00ff)
+			           + (b[0] & 0x00ff00ff) + (b[1] & 0x00ff00ff) + 0x00020002) >> 2;
+			Uint32 ag = (((a[0] >> 8) & 0x00ff00ff) + ((a[1] >> 8) & 0x00ff00ff)
+			           + ((b[0] >> 8) & 0x00ff00ff) + ((b[1] >> 8) & 0x00ff00ff) + 0x00020002) >> 2;
+			to[x] = (rb & 0x00ff00ff) | ((ag & 0x00ff00ff) << 8);
+		}
+	}
+	SDL_UnlockSurface(dst);
+	SDL_UnlockSurface(src);
+	return dst;
+}
+
+/* resample src to exactly w x h pixels, freeing src in the process.
+
+   shrinking walks down the mip chain (halving each time) to the smallest
+   level that is still at least as big as the target, and filters from
+   there, so heavy downscales don't alias.  whole-number enlargements use
+   nearest neighbor to keep pixel art crisp; everything else is bilinear.
+
+   this is meant to be done once, when art is loaded for a given display
+   resolution, so that every blit afterwards is a plain 1:1 copy. */
+SDL_Surface* scale_surface(SDL_Surface *src, int w, int h)
+{
+	if (!src || w <= 0 || h <= 0 || (src->w == w && src->h == h))
+		return src;
+
+	/* filtering a color-keyed image would blend the key color into the
+	   edges of the art, where it no longer matches the key; so filter
+	   keyed art as alpha, and only keep the key for nearest neighbor */
+	int nearest = w % src->w == 0 && h % src->h == 0;
+	SDL_Surface *level = surface_32bpp(src, !nearest);
+	if (level != src)
+		SDL_FreeSurface(src);
+	if (!level)
+		return NULL;
+
+	int filter = level->format->Amask && !nearest;
+	if (filter)
+		premultiply(level, 0);
+
+	while (level->w / 2 >= w && level->h / 2 >= h) {
+		SDL_Surface *next = mip_halve(level);
+		if (!next)
+			break;
+		SDL_FreeSurface(level);
+		level = next;
+	}
+	if (level->w == w && level->h == h) {
+		if (filter)
+			premultiply(level, 1);
+		return level;
+	}
+
+	SDL_Surface *dst = surface_like(level, w, h);
+	if (!dst) {
+		SDL_FreeSurface(level);
+		return NULL;
+	}
+
+	SDL_LockSurface(level);
+	SDL_LockSurface(dst);
+	int x, y;
+	if (nearest) {
+		for (y = 0; y < h; y++) {
+			Uint32 *from = (Uint32 *)((Uint8 *)level->pixels + (y * level->h / h) * level->pitch);
+			Uint32 *to   = (Uint32 *)((Uint8 *)dst->pixels + y * dst->pitch);
+			for (x = 0; x < w; x++)
+				to[x] = from[x * level->w / w];
+		}
+
+	} else {
+		/* sample positions are in 1/256ths of a source pixel,
+		   measured between pixel centers */
+		long max_x = (level->w - 1) * 256L, max_y = (level->h - 1) * 256L;
+		for (y = 0; y < h; y++) {
+			long sy = (2L * y + 1) * level->h * 128 / h - 128;
+			if (sy < 0)     sy = 0;
+			if (sy > max_y) sy = max_y;
+
+			int y0 = sy >> 8, y1 = y0 + (y0 < level->h - 1);
+			Uint32 *r0 = (Uint32 *)((Uint8 *)level->pixels + y0 * level->pitch);
+			Uint32 *r1 = (Uint32 *)((Uint8 *)level->pixels + y1 * level->pitch);
+			Uint32 *to = (Uint32 *)((Uint8 *)dst->pixels + y * dst->pitch);
+
+			for (x = 0; x < w; x++) {
+				long sx = (2L * x + 1) * level->w * 128 / w - 128;
+				if (sx < 0)     sx = 0;
+				if (sx > max_x) sx = max_x;
+
+				int x0 = sx >> 8, x1 = x0 + (x0 < level->w - 1);
+				to[x] = lerp32(lerp32(r0[x0], r0[x1], sx & 0xff),
+				               lerp32(r1[x0], r1[x1], sx & 0xff), sy & 0xff);
+			}
+		}
+	}
+	SDL_UnlockSurface(dst);
+	SDL_UnlockSurface(level);
+	SDL_FreeSurface(level);
+	if (filter)
+		premultiply(dst, 1);
+	return dst;
+}
+
+static int scaled(title_grid_t *grid, int n)
+{
+	return (int)(n * grid->scale + 0.5);
+}
+
+/* one entry per 15-bit (5:5:5) color in an image, for median cut */
+typedef struct {
+	Uint16        key;
+	unsigned long n;       /* how many pixels */
+	unsigned long r, g, b; /* their full-precision channel sums */
+} hist_t;
+
+static int cut_channel; /* 10 (red), 5 (green) or 0 (blue); for cmp_hist() */
+static int cmp_hist(const void *a, const void *b)
+{
+	return ((((const hist_t *)a)->key >> cut_channel) & 0x1f)
+	     - ((((const hist_t *)b)->key >> cut_channel) & 0x1f);
+}
+
+/* median cut: split the histogram into (at most) `want' boxes, each
+   with roughly as many pixels in it, and average each box down to one
+   palette entry.  lookup maps 15-bit keys to palette indices. */
+static int median_cut(hist_t *h, int n, int want, SDL_Color *pal, Uint8 *lookup)
+{
+	int first[256], last[256], boxes = 1;
+	int i, j;
+	first[0] = 0; last[0] = n;
+
+	while (boxes < want) {
+		/* split whichever box has the most pixels (and more than one color) */
+		int best = -1;
+		unsigned long most = 0;
+		for (i = 0; i < boxes; i++) {
+			unsigned long px = 0;
+			if (last[i] - first[i] < 2)
+				continue;
+			for (j = first[i]; j < last[i]; j++)
+				px += h[j].n;
+			if (px > most) {
+				most = px;
+				best = i;
+			}
+		}
+		if (best < 0)
+			break;
+
+		/* ... along whichever channel spans the most ... */
+		int lo[3] = { 31, 31, 31 }, hi[3] = { 0, 0, 0 }, c, widest = 0;
+		for (j = first[best]; j < last[best]; j++) {
+			for (c = 0; c < 3; c++) {
+				int v = (h[j].key >> (10 - 5 * c)) & 0x1f;
+				if (v < lo[c]) lo[c] = v;
+				if (v > hi[c]) hi[c] = v;
+			}
+		}
+		for (c = 1; c < 3; c++)
+			if (hi[c] - lo[c] > hi[widest] - lo[widest])
+				widest = c;
+		cut_channel = 10 - 5 * widest;
+		qsort(h + first[best], last[best] - first[best], sizeof(hist_t), cmp_hist);
+
+		/* ... at the median pixel */
+		unsigned long seen = 0;
+		for (j = first[best]; j < last[best] - 2; j++) {
+			seen += h[j].n;
+			if (seen >= most / 2)
+				break;
+		}
+		first[boxes] = j + 1;
+		last[boxes]  = last[best];
+		last[best]   = j + 1;
+		boxes++;
+	}
+
+	for (i = 0; i < boxes; i++) {
+		unsigned long px = 0, r = 0, g = 0, b = 0;
+		for (j = first[i]; j < last[i]; j++) {
+			px += h[j].n;
+			r  += h[j].r;
+			g  += h[j].g;
+			b  += h[j].b;
+			lookup[h[j].key] = i;
+		}
+		pal[i].r = (r + px / 2) / px;
+		pal[i].g = (g + px / 2) / px;
+		pal[i].b = (b + px / 2) / px;
+	}
+	return boxes;
+}
+
+/* build an 8-bit copy of s (which must be 32-bit, with no partially
+   transparent pixels).  fully transparent pixels become palette entry
+   0, as the color key.  *psnr is set to the peak signal-to-noise ratio
+   of the opaque pixels, which is infinite if they all fit exactly. */
+static SDL_Surface* palettize(SDL_Surface *s, hist_t *hist, int colors, int keyed, double *psnr)
+{
+	SDL_Color pal[256];
+	Uint8 *lookup = calloc(32768, 1);
+	SDL_Surface *p = SDL_CreateRGBSurface(SDL_SWSURFACE, s->w, s->h, 8, 0, 0, 0, 0);
+	if (!lookup || !p) {
+		free(lookup);
+		SDL_FreeSurface(p);
+		return NULL;
+	}
+
+	int i, n = median_cut(hist, colors, keyed ? 255 : 256, pal + keyed, lookup);
+	if (keyed) {
+		pal[0].r = pal[0].g = pal[0].b = 0;
+		for (i = 0; i < 32768; i++)
+			lookup[i]++;
+	}
+	SDL_SetColors(p, pal, 0, n + keyed);
+	if (keyed)
+		SDL_SetColorKey(p, SDL_SRCCOLORKEY, 0);
+
+	double err = 0;
+	unsigned long opaque = 0;
+	int x, y;
+	SDL_LockSurface(s);
+	SDL_LockSurface(p);
+	for (y = 0; y < s->h; y++) {
+		Uint32 *from = (Uint32 *)((Uint8 *)s->pixels + y * s->pitch);
+		Uint8  *to   = (Uint8 *)p->pixels + y * p->pitch;
+		for (x = 0; x < s->w; x++) {
+			Uint8 r, g, b, a;
+			SDL_GetRGBA(from[x], s->format, &r, &g, &b, &a);
+			if (keyed && a == 0) {
+				to[x] = 0;
+				continue;
+			}
+			to[x] = lookup[((r >> 3) << 10) | ((g >> 3) << 5) | (b >> 3)];
+			err += (r - pal[to[x]].r) * (r - pal[to[x]].r)
+			     + (g - pal[to[x]].g) * (g - pal[to[x]].g)
+			     + (b - pal[to[x]].b) * (b - pal[to[x]].b);
+			opaque++;
+		}
+	}
+	SDL_UnlockSurface(p);
+	SDL_UnlockSurface(s);
+	free(lookup);
+
+	err = opaque ? err / (3.0 * opaque) : 0;
+	*psnr = err > 0 ? 10 * log10(255.0 * 255.0 / err) : INFINITY;
+	return p;
+}
+
+/* pick the cheapest way to keep s resident (freeing s if it isn't kept),
+   and track it:
+
+     - as-is;
+     - 8-bit paletted (colorkeyed, if it has transparency), for art with no
+       partial transparency whose palette comes out better than ART_MIN_PSNR.
+       flat-color pixel art usually fits in 256 colors outright;
+     - SDL's RLE encoding, for art with a lot of fully transparent pixels
+       (or pixels in its color key).  SDL throws the original pixels away
+       once it has encoded them, so we size this by counting runs ourselves.
+
+   both of the compact forms blit at least as fast as a 32-bit surface
+   with per-pixel alpha: the palette by table lookup and color key, and
+   RLE by skipping transparent runs outright. */
+SDL_Surface* compact_art(title_grid_t *grid, SDL_Surface *s)
+{
+	if (!s || !grid->compact || s->format->BytesPerPixel < 3)
+		return track_art(s);
+
+	/* analyse a 32-bit view of s, with any color key turned into alpha so
+	   that keyed pixels count as clear; s itself stays put unless one of
+	   the compact forms actually wins */
+	SDL_Surface *c = surface_32bpp(s, 1);
+	if (!c)
+		return track_art(s);
+
+	hist_t *hist = calloc(32768, sizeof(hist_t));
+	if (!hist) {
+		if (c != s)
+			SDL_FreeSurface(c);
+		return track_art(s);
+	}
+
+	unsigned long clear = 0, partial = 0, runs = 0;
+	int x, y, i, colors = 0;
+	SDL_LockSurface(c);
+	for (y = 0; y < c->h; y++) {
+		Uint32 *row = (Uint32 *)((Uint8 *)c->pixels + y * c->pitch);
+		int was_clear = -1;
+		for (x = 0; x < c->w; x++) {
+			Uint8 r, g, b, a;
+			SDL_GetRGBA(row[x], c->format, &r, &g, &b, &a);
+			if (a == 0) {
+				clear++;
+			} else {
+				if (a != 255)
+					partial++;
+
+				hist_t *h = &hist[((r >> 3) << 10) | ((g >> 3) << 5) | (b >> 3)];
+				h->n++;
+				h->r += r;
+				h->g += g;
+				h->b += b;
+			}
+			if ((a == 0) != was_clear)
+				runs++;
+			was_clear = (a == 0);
+		}
+	}
+	SDL_UnlockSurface(c);
+
+	/* squeeze the used entries down to the front, for median_cut() */
+	for (i = 0; i < 32768; i++) {
+		if (!hist[i].n)
+			continue;
+		hist[i].key = i;
+		hist[colors++] = hist[i];
+	}
+
+	size_t raw = surface_bytes(s);
+	size_t pal = ((c->w + 3) & ~3) * c->h + 256 * sizeof(SDL_Color);
+	/* keyed art is encoded against its own key, at its own depth */
+	int keyed = (s->flags & SDL_SRCCOLORKEY) != 0;
+	size_t rle = (keyed ? s->format->BytesPerPixel : 4) * ((unsigned long)c->w * c->h - clear)
+	           + 4 * runs + 4 * c->h;
+	size_t best = raw;
+	const char *how = "as-is";
+	double psnr = INFINITY;
+	SDL_Surface *kept = s;
+
+	if (!partial && colors && pal < raw && (!clear || pal < rle)) {
+		SDL_Surface *p = palettize(c, hist, colors, clear > 0, &psnr);
+		if (p && psnr >= ART_MIN_PSNR) {
+			kept = p;
+			best = pal;
+			how  = clear ? "paletted, keyed" : "paletted";
+		} else {
+			SDL_FreeSurface(p);
+		}
+	}
+	if (kept == s && clear && rle < raw) {
+		if (keyed) {
+			SDL_SetColorKey(s, SDL_SRCCOLORKEY | SDL_RLEACCEL, s->format->colorkey);
+		} else {
+			/* only art with an alpha channel gets here, and that is
+			   already 32-bit, so c is normally s itself */
+			kept = c;
+			SDL_SetAlpha(c, SDL_SRCALPHA | SDL_RLEACCEL, SDL_ALPHA_OPAQUE);
+		}
+
+		/* SDL encodes on the first blit to the viewport (and frees the
+		   original pixels), so get that out of the way now; draw_grid()
+		   paints over the whole viewport before anything is shown. */
+		SDL_Rect one = { 0, 0, 1, 1 };
+		SDL_BlitSurface(kept, &one, grid->viewport, NULL);
+		best = rle;
+		how  = "RLE";
+	}
+	free(hist);
+
+	if (c != s && c != kept)
+		SDL_FreeSurface(c);
+	if (kept != s)
+		SDL_FreeSurface(s);
+	if (kept->format->palette && kept != s) {
+		fprintf(stderr, "storing %ix%i art %s: %zu -> %zu bytes (%.1fdB)\n", kept->w, kept->h, how, raw, best, psnr);
+	} else {
+		fprintf(stderr, "storing %ix%i art %s: %zu -> %zu bytes\n", kept->w, kept->h, how, raw, best);
+	}
+	return track_art_as(kept, best);
+}
+
+/* load a piece of art authored at native resolution, pre-scaled
+   to w x h (or by the layout scale factor, if w and h are 0) */
+SDL_Surface* load_art(title_grid_t *grid, const char *path, int w, int h)
+{
+	SDL_Surface *s = load_png(path, NULL);
+	if (!s)
+		return NULL;
+	if (!w || !h) {
+		w = scaled(grid, s->w);
+		h = scaled(grid, s->h);
+	}
+	return compact_art(grid, scale_surface(s, w, h));
+}
+
+title_t* title_read_from_metadata(title_grid_t *grid, const char *root, const char *dir)
 {
 	title_t *title = vmalloc(sizeof(title_t));
 	title->path = string("%s/%s", root, dir);;
@@ -121,26 +711,26 @@ title_t* title_read_from_metadata(const char *root, const char *dir)
 			title->metadata.released = strdup(value);
 
 		} else if (strcasecmp(key, "INSET") == 0) {
-			SDL_FreeSurface(title->box_inset);
-			SDL_FreeSurface(title->box_overlay);
+			free_art(title->box_inset);
+			free_art(title->box_overlay);
 			title->box_overlay = NULL;
 
 			char *path = string("%s/%s", title->path, value);
 			fprintf(stderr, "loading inset from %s\n", path);
-			title->box_inset = load_png(path, NULL);
+			title->box_inset = load_art(grid, path, 0, 0);
 			if (!title->box_inset) {
 				fprintf(stderr, "%s: failed to load inset; skipping\n", path);
 			}
 			free(path);
 
 		} else if (strcasecmp(key, "overlay") == 0) {
-			SDL_FreeSurface(title->box_overlay);
-			SDL_FreeSurface(title->box_inset);
+			free_art(title->box_overlay);
+			free_art(title->box_inset);
 			title->box_inset = NULL;
 
 			char *path = string("%s/%s", title->path, value);
 			fprintf(stderr, "loading overlay from %s\n", path);
-			title->box_overlay = load_png(path, NULL);
+			title->box_overlay = load_art(grid, path, 0, 0);
 			if (!title->box_overlay) {
 				fprintf(stderr, "%s: failed to load overlay; skipping\n", path);
 			}
@@ -156,18 +746,20 @@ title_t* title_read_from_metadata(const char *root, const char *dir)
 	return title;
 }
 
-title_grid_t* grid_create(const char *root, int width, int height)
+title_grid_t* grid_create(const char *root, SDL_Surface *viewport)
 {
 	title_grid_t *grid = vmalloc(sizeof(title_grid_t));
-	grid->viewport = SDL_SetVideoMode(width, height, 0, SDL_SWSURFACE|SDL_DOUBLEBUF);
-	if (!grid->viewport) {
-		fprintf(stderr, "video mode: %s\n", SDL_GetError());
-		free(grid);
-		return NULL;
-	}
+	grid->viewport = viewport;
 
-	grid->overlay = load_png("assets/overlay.png", NULL);
-	grid->gutter  = 10;
+	grid->scale = (double)grid->viewport->w / NATIVE_WIDTH;
+	if ((double)grid->viewport->h / NATIVE_HEIGHT < grid->scale)
+		grid->scale = (double)grid->viewport->h / NATIVE_HEIGHT;
+	fprintf(stderr, "viewport is %ix%i; scaling layout by %.3f\n", grid->viewport->w, grid->viewport->h, grid->scale);
+
+	grid->gutter  = scaled(grid, 10);
+
+	char *art = getenv("ARCADE_ART");
+	grid->compact = !(art && strcmp(art, "raw") == 0);
 
 	char *path = string("%s/.index", root);
 	FILE *io = fopen(path, "r");
@@ -209,8 +801,8 @@ title_grid_t* grid_create(const char *root, int width, int height)
 
 		if (strcasecmp(key, "BOX") == 0) {
 			char *box_path = string("%s/%s", root, a);
-			SDL_FreeSurface(grid->box);
-			grid->box = load_png(box_path, NULL);
+			free_art(grid->box);
+			grid->box = load_art(grid, box_path, 0, 0);
 			if (!grid->box) {
 				fprintf(stderr, "%s:%u: box image %s not found; aborting\n", path, line, box_path);
 				free(box_path);
@@ -223,13 +815,13 @@ title_grid_t* grid_create(const char *root, int width, int height)
 
 		} else if (strcasecmp(key, "OVERLAY") == 0) {
 			char *overlay_path = string("%s/%s", root, a);
-			SDL_FreeSurface(grid->overlay);
-			grid->overlay = load_png(overlay_path, NULL);
+			free_art(grid->overlay);
+			grid->overlay = load_art(grid, overlay_path, grid->viewport->w, grid->viewport->h);
 			free(overlay_path);
 
 		} else if (strcasecmp(key, "FONT") == 0) {
 			char *font_path = string("%s/%s", root, a);
-			grid->font = TTF_OpenFont(font_path, TITLE_FONT_SIZE);
+			grid->font = TTF_OpenFont(font_path, scaled(grid, TITLE_FONT_SIZE));
 			free(font_path);
 
 		} else if (strcasecmp(key, "INSET") == 0) {
@@ -258,10 +850,10 @@ title_grid_t* grid_create(const char *root, int width, int height)
 			for (b = a; isdigit(*b); b++) h = h * 10 + (*b - '0');
 
 			fprintf(stderr, "setting inset rect to (%i,%i) %ix%i\n", x, y, w, h);
-			grid->inset_rect.x = x;
-			grid->inset_rect.y = y;
-			grid->inset_rect.w = w;
-			grid->inset_rect.h = h;
+			grid->inset_rect.x = scaled(grid, x);
+			grid->inset_rect.y = scaled(grid, y);
+			grid->inset_rect.w = scaled(grid, w);
+			grid->inset_rect.h = scaled(grid, h);
 
 		} else if (strcasecmp(key, "GUTTER") == 0) {
 			int g = 0;
@@ -272,7 +864,7 @@ title_grid_t* grid_create(const char *root, int width, int height)
 				continue;
 			}
 			fprintf(stderr, "setting gutter to %i\n", g);
-			grid->gutter = g;
+			grid->gutter = scaled(grid, g);
 
 		} else if (strcasecmp(key, "HIGHLIGHT") == 0) {
 			int args = 0;
@@ -302,7 +894,7 @@ title_grid_t* grid_create(const char *root, int width, int height)
 			for (b = a; isdigit(*b); b++) A = A * 10 + (*b - '0');
 
 			fprintf(stderr, "setting highlight to %i wide, rgba(%i,%i,%i,%i)\n", w, R, G, B, A);
-			grid->highlight.width = w;
+			grid->highlight.width = scaled(grid, w);
 			grid->highlight.R     = R;
 			grid->highlight.G     = G;
 			grid->highlight.B     = B;
@@ -310,7 +902,7 @@ title_grid_t* grid_create(const char *root, int width, int height)
 
 		} else if (strcasecmp(key, "GAME") == 0) {
 			fprintf(stderr, "checking title %s/%s\n", root, a);
-			title = title_read_from_metadata(root, a);
+			title = title_read_from_metadata(grid, root, a);
 			if (title) {
 				list_push(&titles, &title->staging);
 				n++;
@@ -322,10 +914,16 @@ title_grid_t* grid_create(const char *root, int width, int height)
 	}
 
 	if (!grid->overlay) {
-		grid->overlay = load_png("assets/overlay.png", NULL);
+		grid->overlay = load_art(grid, "assets/overlay.png", grid->viewport->w, grid->viewport->h);
 	}
 	if (!grid->font) {
-		grid->font = TTF_OpenFont("assets/snes.ttf", TITLE_FONT_SIZE);
+		grid->font = TTF_OpenFont("assets/snes.ttf", scaled(grid, TITLE_FONT_SIZE));
+	}
+	char *hud = getenv("ARCADE_HUD");
+	if (hud && *hud && strcmp(hud, "0") != 0) {
+		grid->hud = TTF_OpenFont("assets/snes.ttf", scaled(grid, HUD_FONT_SIZE));
+		if (!grid->hud)
+			fprintf(stderr, "hud font: %s\n", TTF_GetError());
 	}
 	if (!grid->box) {
 		fprintf(stderr, "%s: no box cover art template specified; aborting\n", path);
@@ -352,7 +950,7 @@ title_grid_t* grid_create(const char *root, int width, int height)
 			for (a = s; *a; *a = toupper(*a), a++) ;
 
 			SDL_Color fg = { 255, 255, 255 };
-			title->box_inset = TTF_RenderText_Solid(grid->font, s, fg);
+			title->box_inset = track_art(TTF_RenderText_Solid(grid->font, s, fg));
 
 			free(s);
 		}
@@ -385,8 +983,14 @@ void run_title(title_t *title)
 
 	if (pid > 0) {
 		int st;
+		double start = now_ms();
 		waitpid(pid, &st, 0);
 		fprintf(stderr, "child process exited: %x\n", st);
+
+		stats.launches++;
+		stats.last_launch_ms   = now_ms() - start;
+		stats.total_launch_ms += stats.last_launch_ms;
+		stats.last_status      = st;
 		return;
 	}
 
@@ -440,6 +1044,57 @@ int draw_title(title_grid_t *grid, SDL_Rect *offset, title_t *title)
 	return 1;
 }
 
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+	return x < y ? -1 : x > y ? 1 : 0;
+}
+
+/* frames per second and frame time percentiles, over the last
+   FRAME_SAMPLES frames (or however many we've drawn so far) */
+void frame_stats(double *fps, double *p50, double *p99)
+{
+	double t[FRAME_SAMPLES], sum = 0;
+	int i, n = stats.frames < FRAME_SAMPLES ? stats.frames : FRAME_SAMPLES;
+
+	*fps = *p50 = *p99 = 0;
+	if (!n)
+		return;
+
+	for (i = 0; i < n; i++)
+		sum += (t[i] = stats.frame_ms[i]);
+	qsort(t, n, sizeof(double), cmp_double);
+
+	*fps = sum > 0 ? n * 1000.0 / sum : 0;
+	*p50 = t[(n - 1) * 50 / 100];
+	*p99 = t[(n - 1) * 99 / 100];
+}
+
+void draw_hud(title_grid_t *grid)
+{
+	double fps, p50, p99;
+	frame_stats(&fps, &p50, &p99);
+
+	char line[2][128];
+	snprintf(line[0], sizeof(line[0]), "%.1f FPS   p50 %.2fms   p99 %.2fms", fps, p50, p99);
+	snprintf(line[1], sizeof(line[1]), "%i SURFACES   %.1f MB ART", stats.surfaces, stats.art_bytes / 1048576.0);
+
+	SDL_Color fg = { 255, 255, 0 };
+	SDL_Rect at = { scaled(grid, 8), scaled(grid, 8), 0, 0 };
+	int i;
+	for (i = 0; i < 2; i++) {
+		SDL_Surface *text = TTF_RenderText_Solid(grid->hud, line[i], fg);
+		if (!text)
+			continue;
+
+		SDL_Rect bg = { at.x - 2, at.y, text->w + 4, text->h };
+		SDL_FillRect(grid->viewport, &bg, SDL_MapRGBA(grid->viewport->format, 0, 0, 0, 255));
+		SDL_BlitSurface(text, NULL, grid->viewport, &at);
+		at.y += text->h;
+		SDL_FreeSurface(text);
+	}
+}
+
 int draw_grid(title_grid_t *grid)
 {
 	SDL_Rect off = { grid->margin, 0, 0, 0 };
@@ -482,11 +1137,291 @@ int draw_grid(title_grid_t *grid)
 	}
 
 	SDL_BlitSurface(grid->overlay, NULL, grid->viewport, NULL);
+	if (grid->hud)
+		draw_hud(grid);
 	return 0;
 }
 
+typedef struct {
+	char     magic[8];    /* SESSION_MAGIC */
+	uint64_t fingerprint; /* catalog_fingerprint() at save time */
+	int32_t  current;     /* index of selected title */
+
+	/* the last composited frame follows, in raw display format */
+	int32_t  w, h, pitch;
+	uint32_t bpp, Rmask, Gmask, Bmask;
+} session_t;
+
+static uint64_t fnv1a(uint64_t h, const void *data, size_t len)
+{
+	const unsigned char *p = data;
+	while (len--)
+		h = (h ^ *p++) * 0x100000001b3ULL;
+	return h;
+}
+
+/* hash a metadata file (.index or .title), the size and mtime of any
+   art it points at, and (for GAME entries) the title's own metadata */
+static uint64_t fingerprint_file(uint64_t h, const char *dir, const char *file)
+{
+	char *path = string("%s/%s", dir, file);
+	FILE *io = fopen(path, "r");
+	free(path);
+	if (!io)
+		return h;
+
+	char buf[8192], key[64], value[8192];
+	while (fgets(buf, 8191, io) != NULL) {
+		h = fnv1a(h, buf, strlen(buf));
+		if (sscanf(buf, " %63s %8191[^\n]", key, value) != 2 || key[0] == '#')
+			continue;
+
+		if (strcasecmp(key, "GAME") == 0) {
+			char *sub = string("%s/%s", dir, value);
+			h = fingerprint_file(h, sub, ".title");
+			free(sub);
+
+		} else if (strcasecmp(key, "BOX") == 0 || strcasecmp(key, "OVERLAY") == 0
+		        || strcasecmp(key, "FONT") == 0 || strcasecmp(key, "INSET") == 0) {
+			struct stat st;
+			char *art = string("%s/%s", dir, value);
+			if (stat(art, &st) == 0) {
+				int64_t meta[2] = { st.st_size, st.st_mtime };
+				h = fnv1a(h, meta, sizeof(meta));
+			}
+			free(art);
+		}
+	}
+	fclose(io);
+	return h;
+}
+
+/* FNV-1a over the catalog (index, per-title metadata, and the art they
+   reference) and the display format; if any of that changes, a saved
+   frame (and selection) can't be trusted. */
+uint64_t catalog_fingerprint(const char *root, SDL_Surface *viewport)
+{
+	int32_t fmt[5] = { viewport->w, viewport->h, viewport->pitch, viewport->format->BitsPerPixel, viewport->format->Rmask };
+	uint64_t h = fnv1a(0xcbf29ce484222325ULL, fmt, sizeof(fmt));
+	return fingerprint_file(h, root, ".index");
+}
+
+/* open a new, uniquely named file next to path, to be renamed over it
+   by replace_commit() once it's complete.  mkstemp() always creates the
+   file itself, so it can't be pointed at something else by a link
+   planted in a shared directory like /var/tmp. */
+static FILE* replace_open(const char *path, char **tmp)
+{
+	*tmp = string("%s.XXXXXX", path);
+	int fd = mkstemp(*tmp);
+	if (fd < 0) {
+		fprintf(stderr, "%s: %s\n", *tmp, strerror(errno));
+		free(*tmp);
+		*tmp = NULL;
+		return NULL;
+	}
+	fchmod(fd, 0644);
+
+	FILE *io = fdopen(fd, "w");
+	if (!io) {
+		fprintf(stderr, "%s: %s\n", *tmp, strerror(errno));
+		close(fd);
+		unlink(*tmp);
+		free(*tmp);
+		*tmp = NULL;
+	}
+	return io;
+}
+
+/* finish a file from replace_open(): get it onto the disk before it
+   takes path's place, so a power cut leaves either the old file or
+   the whole new one.  if ok is false (or anything fails), the new file
+   is thrown away and path is left alone. */
+static int replace_commit(FILE *io, char *tmp, const char *path, int ok)
+{
+	ok = ok && fflush(io) == 0 && fsync(fileno(io)) == 0;
+	ok = fclose(io) == 0 && ok;
+	ok = ok && rename(tmp, path) == 0;
+	if (!ok)
+		unlink(tmp);
+	free(tmp);
+	return ok ? 0 : 1;
+}
+
+int session_save(const char *file, title_grid_t *grid)
+{
+	SDL_Surface *v = grid->viewport;
+	session_t s;
+	memset(&s, 0, sizeof(s));
+	memcpy(s.magic, SESSION_MAGIC, sizeof(s.magic));
+	s.fingerprint = grid->fingerprint;
+	s.current     = grid->current;
+	s.w     = v->w;
+	s.h     = v->h;
+	s.pitch = v->pitch;
+	s.bpp   = v->format->BitsPerPixel;
+	s.Rmask = v->format->Rmask;
+	s.Gmask = v->format->Gmask;
+	s.Bmask = v->format->Bmask;
+
+	/* write it somewhere else and rename it into place, so that
+	   pulling the plug mid-write can't leave us a torn frame */
+	char *tmp;
+	FILE *io = replace_open(file, &tmp);
+	if (!io)
+		return 1;
+
+	SDL_LockSurface(v);
+	int ok = fwrite(&s, sizeof(s), 1, io) == 1
+	      && fwrite(v->pixels, v->pitch, v->h, io) == (size_t)v->h;
+	SDL_UnlockSurface(v);
+
+	if (replace_commit(io, tmp, file, ok) != 0) {
+		fprintf(stderr, "%s: failed to save session snapshot\n", file);
+		return 1;
+	}
+	return 0;
+}
+
+/* paint the saved frame into the viewport, if it was saved against the
+   same catalog and display format.  returns the saved selection, or -1
+   if there was no usable snapshot (and nothing was drawn). */
+int session_restore(const char *file, uint64_t fingerprint, SDL_Surface *v)
+{
+	FILE *io = fopen(file, "r");
+	if (!io)
+		return -1;
+
+	session_t s;
+	if (fread(&s, sizeof(s), 1, io) != 1
+	 || memcmp(s.magic, SESSION_MAGIC, sizeof(s.magic)) != 0
+	 || s.fingerprint != fingerprint
+	 || s.w != v->w || s.h != v->h || s.pitch != v->pitch
+	 || s.bpp != v->format->BitsPerPixel
+	 || s.Rmask != v->format->Rmask || s.Gmask != v->format->Gmask || s.Bmask != v->format->Bmask) {
+		fprintf(stderr, "%s: session snapshot is stale; ignoring\n", file);
+		fclose(io);
+		return -1;
+	}
+
+	SDL_LockSurface(v);
+	int ok = fread(v->pixels, v->pitch, v->h, io) == (size_t)v->h;
+	SDL_UnlockSurface(v);
+	fclose(io);
+
+	if (!ok) {
+		fprintf(stderr, "%s: session snapshot is truncated; ignoring\n", file);
+		SDL_FillRect(v, NULL, SDL_MapRGBA(v->format, 0, 0, 0, 255));
+		return -1;
+	}
+	return s.current;
+}
+
+void stats_dump(FILE *io)
+{
+	double fps, p50, p99;
+	frame_stats(&fps, &p50, &p99);
+
+	fprintf(io, "{\"uptime_ms\":%.1f,"
+	            "\"frames\":%lu,\"fps\":%.2f,\"frame_ms\":{\"p50\":%.3f,\"p99\":%.3f},"
+	            "\"art\":{\"surfaces\":%i,\"bytes\":%zu},"
+	            "\"load\":{\"first_pixel_ms\":%.1f,\"interactive_ms\":%.1f,\"grid_ms\":%.1f},"
+	            "\"launch\":{\"count\":%lu,\"last_ms\":%.1f,\"total_ms\":%.1f,\"last_status\":%i}}\n",
+		now_ms() - stats.boot,
+		stats.frames, fps, p50, p99,
+		stats.surfaces, stats.art_bytes,
+		stats.first_pixel, stats.interactive, stats.load_ms,
+		stats.launches, stats.last_launch_ms, stats.total_launch_ms, stats.last_status);
+}
+
+static void on_sigusr1(int sig)
+{
+	stats_requested = 1;
+}
+
+int stats_listen(const char *file)
+{
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (strlen(file) >= sizeof(addr.sun_path)) {
+		fprintf(stderr, "%s: socket path too long\n", file);
+		return -1;
+	}
+	strcpy(addr.sun_path, file);
+
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fd < 0) {
+		perror("stats socket");
+		return -1;
+	}
+	unlink(file);
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, 8) != 0) {
+		fprintf(stderr, "%s: %s\n", file, strerror(errno));
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+/* answer any pending stats requests; called once per frame,
+   so it must never block */
+void stats_service(int listener)
+{
+	if (stats_requested) {
+		stats_requested = 0;
+
+		char *tmp;
+		FILE *io = replace_open(STATS_FILE, &tmp);
+		if (io) {
+			stats_dump(io);
+			if (replace_commit(io, tmp, STATS_FILE, 1) != 0)
+				fprintf(stderr, "%s: failed to write stats\n", STATS_FILE);
+		}
+	}
+
+	int fd;
+	while (listener >= 0 && (fd = accept4(listener, NULL, NULL, SOCK_CLOEXEC)) >= 0) {
+		/* a single dump fits comfortably in the socket buffer; send it
+		   with MSG_NOSIGNAL so a client that hangs up early can't kill
+		   us with SIGPIPE (ignoring SIGPIPE would leak into the games
+		   we exec) */
+		char *buf = NULL;
+		size_t len = 0;
+		FILE *io = open_memstream(&buf, &len);
+		if (io) {
+			stats_dump(io);
+			if (fclose(io) == 0)
+				send(fd, buf, len, MSG_NOSIGNAL);
+			free(buf);
+		}
+		close(fd);
+	}
+}
+
+void stats_frame(void)
+{
+	double now = now_ms();
+	if (stats.last_frame > 0)
+		stats.frame_ms[stats.frames++ % FRAME_SAMPLES] = now - stats.last_frame;
+	stats.last_frame = now;
+}
+
 int main(int argc, char **argv)
 {
+	double boot = stats.boot = now_ms();
+
+	/* install early: SIGUSR1's default action is to terminate, and a
+	   request that lands during boot is answered on the first frame */
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = on_sigusr1;
+	sa.sa_flags   = SA_RESTART;
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGUSR1, &sa, NULL);
+
+	const char *root = "/opt/arcade/roms/snes";
+
 	if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_JOYSTICK) != 0) {
 		fprintf(stderr, "SDL: %s\n", SDL_GetError());
 		return 1;
@@ -517,12 +1452,62 @@ int main(int argc, char **argv)
 		return 1;
 	}
 
-	title_grid_t *grid = grid_create("/opt/arcade/roms/snes", 1280, 768);
+	/* run at whatever the display is natively set to (SDL reports the
+	   desktop mode up until the first SDL_SetVideoMode), unless told
+	   otherwise via ARCADE_RESOLUTION=WxH */
+	int width = NATIVE_WIDTH, height = NATIVE_HEIGHT;
+	const SDL_VideoInfo *info = SDL_GetVideoInfo();
+	if (info && info->current_w > 0 && info->current_h > 0) {
+		width  = info->current_w;
+		height = info->current_h;
+	}
+	char *res = getenv("ARCADE_RESOLUTION");
+	if (res) {
+		int w, h;
+		if (sscanf(res, "%ix%i", &w, &h) == 2 && w > 0 && h > 0) {
+			width  = w;
+			height = h;
+		} else {
+			fprintf(stderr, "ARCADE_RESOLUTION=%s: expected WIDTHxHEIGHT; ignoring\n", res);
+		}
+	}
+
+	SDL_Surface *viewport = SDL_SetVideoMode(width, height, 0, SDL_SWSURFACE|SDL_DOUBLEBUF);
+	if (!viewport) {
+		fprintf(stderr, "video mode: %s\n", SDL_GetError());
+		return 1;
+	}
+
+	/* put the last frame we showed back up while we parse
+	   the catalog and decode all of the art behind it */
+	uint64_t fingerprint = catalog_fingerprint(root, viewport);
+	int current = session_restore(SESSION_FILE, fingerprint, viewport);
+	if (current >= 0) {
+		SDL_Flip(viewport);
+		stats.first_pixel = now_ms() - boot;
+		fprintf(stderr, "time to first pixel: %.1fms (session snapshot)\n", stats.first_pixel);
+	}
+
+	double start = now_ms();
+	title_grid_t *grid = grid_create(root, viewport);
+	stats.load_ms = now_ms() - start;
 	if (!grid) {
 		fprintf(stderr, "failed to initialize title grid\n");
 		return 1;
 	}
-	grid->current = 0;
+	grid->fingerprint = fingerprint;
+	grid->current = current >= 0 && current < grid->length ? current : 0;
+
+	draw_grid(grid);
+	SDL_Flip(grid->viewport);
+	stats.interactive = now_ms() - boot;
+	if (current < 0) {
+		stats.first_pixel = stats.interactive;
+		fprintf(stderr, "time to first pixel: %.1fms (no usable session snapshot)\n", stats.first_pixel);
+	}
+	fprintf(stderr, "time to interactive: %.1fms (grid built in %.1fms)\n", stats.interactive, stats.load_ms);
+
+	int listener = stats_listen(STATS_SOCKET);
 
 	int loop = 1;
 	while (SDL_PollEvent(&ev)) ;
@@ -600,20 +1585,31 @@ int main(int argc, char **argv)
 
 		} else if (move_y != 0) {
 			if (grid->current > grid->width - 1 && move_y < 0)
-				grid->current -= 3;
-			else if (grid->current < grid->length - 3 && move_y > 0)
-				grid->current += 3;
+				grid->current -= grid->width;
+			else if (grid->current < grid->length - grid->width && move_y > 0)
+				grid->current += grid->width;
 
 		} else if (exec) {
 			// only on start (7)
+			session_save(SESSION_FILE, grid);
 			run_title(grid->titles[grid->current]);
 			while (SDL_PollEvent(&ev)) ;
+			stats.last_frame = 0; /* don't count the game as one long frame */
 		}
 
 		draw_grid(grid);
 		SDL_Flip(grid->viewport);
+		stats_frame();
+		stats_service(listener);
+	}
+
+	if (listener >= 0) {
+		close(listener);
+		unlink(STATS_SOCKET);
 	}
 
+	session_save(SESSION_FILE, grid);
+
 	TTF_Quit();
 	IMG_Quit();
 	SDL_Quit();
@@ -5,7 +5,12 @@
 */
 
 /* Defines */
-#define NUM_DOTS 1024
+#define DEFAULT_DOTS 1024
+#define MAX_THREADS 64
+#define DOT_ALIGN 8 /* Dot arrays are padded to this many dots so SIMD never needs a tail loop */
+#define TILE_SIZE 64 /* Screen is drawn in tiles this many pixels square; also the biggest a dot can be */
+#define MAX_SPEED 16.0f /* Attraction can't wind dots up past this */
+#define BENCH_STEPS 20 /* Steps timed at each size by -b */
 
 #define RES_X  1280
 #define RES_Xf (RES_X * 1.0)
@@ -14,23 +19,77 @@
 #define RES_Yf (RES_Y * 1.0)
 
 /* Includes */
+#define _GNU_SOURCE
 #include <time.h>
+#include <math.h>
 #include <SDL.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define DEMO_X86 /* SSE2/AVX paths, picked at runtime */
+#include <immintrin.h>
+#endif
 
 /* Types */
 typedef struct
 {
-	int red,green; /* The shade of color in red,green. blue is always 0 since we're using it as the background */
-	float vx,vy; /* Speed the particle is moving */
-	float x,y; /* Current position of particle */
-}dot;
+	int count; /* How many dots there are */
+	int padded; /* count, rounded up to DOT_ALIGN */
+	float *x,*y; /* Current position of each dot */
+	float *vx,*vy; /* Speed each dot is moving */
+	Uint32 *color; /* Mapped once, up front. Random red,green; blue is always 0 since we're using it as the background */
+}dots;
+
+typedef struct
+{
+	int size; /* Edge length of a cell, in pixels */
+	int cols,rows; /* Cells across and down */
+	int buckets; /* One per cell, or for a spatial hash a power of two; cells this far apart in reading order share one */
+	Uint32 mask; /* Cell number to bucket */
+	int *start; /* Where each bucket's dots begin in index, plus one past the end */
+	int *count; /* Dots per bucket, then where the next one goes; each worker only touches its own range of buckets */
+	Uint32 *cell; /* Which bucket each dot is in */
+	Uint32 *staged; /* Dots, grouped by which worker's range of buckets they fall in */
+	Uint32 *index; /* Dots, grouped by bucket */
+	int part[MAX_THREADS][MAX_THREADS]; /* Dots each worker found for each worker's range of buckets, then where it stages them */
+	int base[MAX_THREADS+1]; /* Where each worker's range of buckets starts in staged, and in index */
+}bins;
+
+typedef void (*demo_job)(int worker,int first,int last); /* Handles items [first,last) */
 
 /* Globals */
 SDL_Surface *demo_screen;
-float demo_time_measure = 0.0f;
+double demo_time_measure = 0.0;
 float demo_time_step = 0.0f;
-dot demo_dots[NUM_DOTS];
+dots demo_dots;
+void (*demo_move)(int worker,int first,int last);
+const char *demo_move_name;
+int demo_threads = 1;
+pthread_t demo_pool[MAX_THREADS];
+pthread_barrier_t demo_pool_start,demo_pool_done;
+demo_job demo_pool_job;
+int demo_pool_items;
+double demo_stat_dots = 0.0,demo_stat_update = 0.0; /* Dots moved and seconds spent moving them, since the last report */
+double demo_stat_fill = 0.0,demo_stat_draw = 0.0; /* Pixels written and seconds spent drawing, since the last report */
+bins demo_tiles;
+bins *demo_binning; /* What the bin jobs are working on */
+int demo_dot_size = 1;
+int demo_additive = 0;
+Uint32 *demo_pixels; /* Locked screen, for the raster jobs */
+int demo_rank;
+double demo_tile_fill[MAX_THREADS][8]; /* Pixels written by each worker; padded out so workers don't share cache lines */
+int demo_interact = 0;
+float demo_radius = 1.0f; /* Dots collide when their centers are closer than twice this */
+float demo_attract = 0.0f; /* How hard dots pull on each other, out to twice the collision distance */
+float demo_range = 2.0f; /* Furthest apart two dots can be and still interact */
+bins demo_grid; /* Spatial hash for interactions; cells are demo_range across */
+float *demo_nvx,*demo_nvy; /* Speeds after this step's interactions */
+float *demo_sx,*demo_sy,*demo_svx,*demo_svy; /* Positions and speeds copied out in grid order, so neighbors sit together in memory */
+double demo_heat[MAX_THREADS][8]; /* Energy into and out of each worker's interactions; padded like demo_tile_fill */
+float demo_cool = 1.0f; /* Scales speeds on the next step to undo whatever energy interactions added or lost */
+double demo_stat_steps = 0.0;
 
 /* Returns a random floating point number between 0.0f and 1.0f */
 float demo_roll()
@@ -41,106 +100,768 @@ float demo_roll()
 	return r;
 }
 
-/* Initialize dots */
-void demo_init()
+/* Returns seconds on a clock that keeps going while we wait on the screen */
+double demo_seconds()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return ts.tv_sec+ts.tv_nsec/1000000000.0;
+}
+
+/* Allocate an array of n dots' worth of something, aligned for AVX and zeroed */
+void *demo_array(int n,size_t size)
+{
+	void *p;
+	if(posix_memalign(&p,32,n*size) != 0)
+	{
+		fprintf(stderr,"Could not allocate %i dots\n",n);
+		exit(1);
+	}
+	memset(p,0,n*size);
+	return p;
+}
+
+/* How many of n items go in each worker's slice; a multiple of DOT_ALIGN so SIMD loads stay aligned */
+int demo_chunk(int n)
+{
+	int chunk;
+	chunk = (n+demo_threads-1)/demo_threads;
+	return (chunk+DOT_ALIGN-1)/DOT_ALIGN*DOT_ALIGN;
+}
+
+/* Run one worker's share of the current job; slices are contiguous */
+void demo_slice(int worker)
+{
+	int chunk,first,last;
+	chunk = demo_chunk(demo_pool_items);
+	first = worker*chunk;
+	last = first+chunk;
+	if(first > demo_pool_items)
+		first = demo_pool_items;
+	if(last > demo_pool_items)
+		last = demo_pool_items;
+	/* Run even when the slice is empty, so jobs that set up per-worker state (demo_bin_count) always do */
+	demo_pool_job(worker,first,last);
+}
+
+/* Worker thread; waits for a job, does its slice, repeat. A NULL job means quit */
+void *demo_worker(void *arg)
+{
+	int worker = (int)(intptr_t)arg;
+	for(;;)
+	{
+		pthread_barrier_wait(&demo_pool_start);
+		if(!demo_pool_job)
+			break;
+		demo_slice(worker);
+		pthread_barrier_wait(&demo_pool_done);
+	}
+	return NULL;
+}
+
+/* Split job over items [0,n) across every thread (the calling thread is worker 0) and wait for it to finish */
+void demo_parallel(demo_job job,int n)
+{
+	demo_pool_job = job;
+	demo_pool_items = n;
+	if(demo_threads > 1)
+		pthread_barrier_wait(&demo_pool_start);
+	demo_slice(0);
+	if(demo_threads > 1)
+		pthread_barrier_wait(&demo_pool_done);
+}
+
+/* Start worker threads */
+void demo_pool_init()
 {
 	int i;
-	for(i = 0;i < NUM_DOTS;i++)
+	if(demo_threads < 2)
+		return;
+	pthread_barrier_init(&demo_pool_start,NULL,demo_threads);
+	pthread_barrier_init(&demo_pool_done,NULL,demo_threads);
+	for(i = 1;i < demo_threads;i++)
 	{
-		demo_dots[i].red = rand()%255;
-		demo_dots[i].green = rand()%255;
-		demo_dots[i].vx = demo_roll()*16.0f-8.0f;
-		demo_dots[i].vy = demo_roll()*16.0f-8.0f;
-		demo_dots[i].x = demo_roll()*RES_Xf;
-		demo_dots[i].y = demo_roll()*RES_Yf;
+		if(pthread_create(&demo_pool[i],NULL,demo_worker,(void*)(intptr_t)i) != 0)
+		{
+			fprintf(stderr,"Could not start worker thread %i\n",i);
+			exit(1);
+		}
 	}
 }
 
-/* Handle dots */
-void demo_handle()
+/* Stop worker threads */
+void demo_pool_quit()
+{
+	int i;
+	if(demo_threads < 2)
+		return;
+	demo_pool_job = NULL;
+	pthread_barrier_wait(&demo_pool_start);
+	for(i = 1;i < demo_threads;i++)
+		pthread_join(demo_pool[i],NULL);
+	pthread_barrier_destroy(&demo_pool_start);
+	pthread_barrier_destroy(&demo_pool_done);
+}
+
+/*
+	Move dots [first,last), bouncing off walls. Every version does the same thing:
+	a dot whose move would take it off screen stays put and has that speed reversed.
+	The SIMD ones do it with masks instead of branches.
+*/
+void demo_move_scalar(int worker,int first,int last)
 {
 	int i;
-	for(i = 0;i < NUM_DOTS;i++)
+	float nx,ny;
+	float *x = demo_dots.x,*y = demo_dots.y,*vx = demo_dots.vx,*vy = demo_dots.vy;
+	for(i = first;i < last;i++)
 	{
 		/* Move */
-		demo_dots[i].x += demo_dots[i].vx*demo_time_step;
-		demo_dots[i].y += demo_dots[i].vy*demo_time_step;
-		/* Hit walls? */
-		if(demo_dots[i].x < 0.0f || demo_dots[i].x >= RES_Xf)
+		nx = x[i]+vx[i]*demo_time_step;
+		ny = y[i]+vy[i]*demo_time_step;
+		/* Hit walls? Keep the old position and reverse */
+		vx[i] = (nx < 0.0f || nx >= RES_Xf) ? -vx[i] : vx[i];
+		x[i] = (nx < 0.0f || nx >= RES_Xf) ? x[i] : nx;
+		vy[i] = (ny < 0.0f || ny >= RES_Yf) ? -vy[i] : vy[i];
+		y[i] = (ny < 0.0f || ny >= RES_Yf) ? y[i] : ny;
+	}
+}
+
+#ifdef DEMO_X86
+__attribute__((target("sse2")))
+void demo_move_sse2(int worker,int first,int last)
+{
+	int i;
+	__m128 step = _mm_set1_ps(demo_time_step);
+	__m128 zero = _mm_setzero_ps();
+	__m128 sign = _mm_set1_ps(-0.0f);
+	__m128 res_x = _mm_set1_ps(RES_Xf),res_y = _mm_set1_ps(RES_Yf);
+	__m128 p,v,n,out;
+	for(i = first;i < last;i += 4)
+	{
+		/* X: move, find lanes that left the screen, keep their old position and flip their speed */
+		p = _mm_load_ps(demo_dots.x+i);
+		v = _mm_load_ps(demo_dots.vx+i);
+		n = _mm_add_ps(p,_mm_mul_ps(v,step));
+		out = _mm_or_ps(_mm_cmplt_ps(n,zero),_mm_cmpge_ps(n,res_x));
+		_mm_store_ps(demo_dots.x+i,_mm_or_ps(_mm_and_ps(out,p),_mm_andnot_ps(out,n)));
+		_mm_store_ps(demo_dots.vx+i,_mm_xor_ps(v,_mm_and_ps(out,sign)));
+		/* Y: same again */
+		p = _mm_load_ps(demo_dots.y+i);
+		v = _mm_load_ps(demo_dots.vy+i);
+		n = _mm_add_ps(p,_mm_mul_ps(v,step));
+		out = _mm_or_ps(_mm_cmplt_ps(n,zero),_mm_cmpge_ps(n,res_y));
+		_mm_store_ps(demo_dots.y+i,_mm_or_ps(_mm_and_ps(out,p),_mm_andnot_ps(out,n)));
+		_mm_store_ps(demo_dots.vy+i,_mm_xor_ps(v,_mm_and_ps(out,sign)));
+	}
+}
+
+__attribute__((target("avx")))
+void demo_move_avx(int worker,int first,int last)
+{
+	int i;
+	__m256 step = _mm256_set1_ps(demo_time_step);
+	__m256 zero = _mm256_setzero_ps();
+	__m256 sign = _mm256_set1_ps(-0.0f);
+	__m256 res_x = _mm256_set1_ps(RES_Xf),res_y = _mm256_set1_ps(RES_Yf);
+	__m256 p,v,n,out;
+	for(i = first;i < last;i += 8)
+	{
+		/* X: move, find lanes that left the screen, keep their old position and flip their speed */
+		p = _mm256_load_ps(demo_dots.x+i);
+		v = _mm256_load_ps(demo_dots.vx+i);
+		n = _mm256_add_ps(p,_mm256_mul_ps(v,step));
+		out = _mm256_or_ps(_mm256_cmp_ps(n,zero,_CMP_LT_OQ),_mm256_cmp_ps(n,res_x,_CMP_GE_OQ));
+		_mm256_store_ps(demo_dots.x+i,_mm256_blendv_ps(n,p,out));
+		_mm256_store_ps(demo_dots.vx+i,_mm256_xor_ps(v,_mm256_and_ps(out,sign)));
+		/* Y: same again */
+		p = _mm256_load_ps(demo_dots.y+i);
+		v = _mm256_load_ps(demo_dots.vy+i);
+		n = _mm256_add_ps(p,_mm256_mul_ps(v,step));
+		out = _mm256_or_ps(_mm256_cmp_ps(n,zero,_CMP_LT_OQ),_mm256_cmp_ps(n,res_y,_CMP_GE_OQ));
+		_mm256_store_ps(demo_dots.y+i,_mm256_blendv_ps(n,p,out));
+		_mm256_store_ps(demo_dots.vy+i,_mm256_xor_ps(v,_mm256_and_ps(out,sign)));
+	}
+}
+#endif
+
+/*
+	Set up bins of size x size pixels covering w x h, for up to n dots. A spatial hash gets about
+	two buckets per dot (never more than there are cells), so its memory follows the dots rather
+	than the screen
+*/
+void demo_bins_init(bins *b,int size,int w,int h,int n,int hashed)
+{
+	int i;
+	b->size = size;
+	b->cols = (w+size-1)/size;
+	b->rows = (h+size-1)/size;
+	b->buckets = b->cols*b->rows;
+	b->mask = 0xffffffff;
+	if(hashed)
+	{
+		for(i = 1;i < 2*n;i *= 2)
+			;
+		if(i < b->buckets)
+		{
+			b->buckets = i;
+			b->mask = i-1;
+		}
+	}
+	b->start = demo_array(b->buckets+1,sizeof(int));
+	b->count = demo_array(b->buckets,sizeof(int));
+	b->cell = demo_array(n,sizeof(Uint32));
+	b->staged = demo_array(n,sizeof(Uint32));
+	b->index = demo_array(n,sizeof(Uint32));
+}
+
+/* Which cell a point is in; clamped, so a dot that strays off screen still lands somewhere */
+int demo_bin_cell(bins *b,float x,float y)
+{
+	int cx,cy;
+	cx = (int)x/b->size;
+	cy = (int)y/b->size;
+	cx = cx < 0 ? 0 : cx >= b->cols ? b->cols-1 : cx;
+	cy = cy < 0 ? 0 : cy >= b->rows ? b->rows-1 : cy;
+	return cy*b->cols+cx;
+}
+
+/* Find each dot's bucket, and count up how many land in each worker's range of buckets */
+void demo_bin_count(int worker,int first,int last)
+{
+	int i,chunk;
+	bins *b = demo_binning;
+	int *part = b->part[worker];
+	chunk = demo_chunk(b->buckets);
+	memset(part,0,demo_threads*sizeof(int));
+	for(i = first;i < last;i++)
+	{
+		b->cell[i] = demo_bin_cell(b,demo_dots.x[i],demo_dots.y[i])&b->mask;
+		part[b->cell[i]/chunk]++;
+	}
+}
+
+/* Hand each dot to the worker whose range of buckets it's in; same slices as demo_bin_count, so each worker's offsets are its own */
+void demo_bin_stage(int worker,int first,int last)
+{
+	int i,chunk;
+	bins *b = demo_binning;
+	int *next = b->part[worker];
+	chunk = demo_chunk(b->buckets);
+	for(i = first;i < last;i++)
+		b->staged[next[b->cell[i]/chunk]++] = i;
+}
+
+/* Counting sort of the dots staged for buckets [first,last), which are this worker's alone */
+void demo_bin_sort(int worker,int first,int last)
+{
+	int c,k,total;
+	Uint32 i;
+	bins *b = demo_binning;
+	int *count = b->count;
+	memset(count+first,0,(last-first)*sizeof(int));
+	for(k = b->base[worker];k < b->base[worker+1];k++)
+		count[b->cell[b->staged[k]]]++;
+	total = b->base[worker];
+	for(c = first;c < last;c++)
+	{
+		b->start[c] = total;
+		total += count[c];
+		count[c] = b->start[c];
+	}
+	for(k = b->base[worker];k < b->base[worker+1];k++)
+	{
+		i = b->staged[k];
+		b->index[count[b->cell[i]]++] = i;
+	}
+}
+
+/*
+	Sort every dot into bins. A counting sort in two stable passes: first by which worker's range
+	of buckets a dot is in, then by bucket within each range. Nothing needs counts for every bucket
+	per worker, the only serial step is threads x threads, and each bucket's dots stay in dot order
+*/
+void demo_bin(bins *b)
+{
+	int w,o,n,total;
+	demo_binning = b;
+	demo_parallel(demo_bin_count,demo_dots.count);
+	/* Range by range, each worker's dots after the last worker's */
+	total = 0;
+	for(o = 0;o < demo_threads;o++)
+	{
+		b->base[o] = total;
+		for(w = 0;w < demo_threads;w++)
+		{
+			n = b->part[w][o];
+			b->part[w][o] = total;
+			total += n;
+		}
+	}
+	b->base[demo_threads] = total;
+	demo_parallel(demo_bin_stage,demo_dots.count);
+	demo_parallel(demo_bin_sort,b->buckets);
+	b->start[b->buckets] = total;
+}
+
+/* Add two pixels a byte at a time, saturating each byte at 255 */
+Uint32 demo_add_pixel(Uint32 a,Uint32 b)
+{
+	Uint32 sum,high,carry;
+	sum = (a&0x7f7f7f7f)+(b&0x7f7f7f7f); /* Low seven bits of each byte; can't carry into the next */
+	high = (a^b)&0x80808080;
+	carry = ((a&b)|(sum&high))&0x80808080; /* Bytes that overflowed */
+	return (sum^high)|carry|(carry-(carry>>7));
+}
+
+/* Rasterize tiles [first,last). Every pixel a worker writes is inside its own tiles, so no locking */
+void demo_raster(int worker,int first,int last)
+{
+	int t,tx,ty,nx,ny,i,j,x,y,x0,y0,x1,y1,left,top,right,bottom,reach;
+	double fill = 0.0;
+	Uint32 *row,color;
+	bins *b = &demo_tiles;
+	/* Dots bigger than a pixel can spill over from a neighboring tile */
+	reach = demo_dot_size > 1 ? 1 : 0;
+	for(t = first;t < last;t++)
+	{
+		tx = t%b->cols;
+		ty = t/b->cols;
+		/* This tile's pixels */
+		left = tx*b->size;
+		top = ty*b->size;
+		right = left+b->size < demo_screen->w ? left+b->size : demo_screen->w;
+		bottom = top+b->size < demo_screen->h ? top+b->size : demo_screen->h;
+		for(ny = ty-reach;ny <= ty+reach;ny++)
 		{
-			/* Undo move (demo_time_step is still the same value it was before and is valid for the current frame) */
-			demo_dots[i].x -= demo_dots[i].vx*demo_time_step;
-			/* Reverse */
-			demo_dots[i].vx = -demo_dots[i].vx;
+			if(ny < 0 || ny >= b->rows)
+				continue;
+			for(nx = tx-reach;nx <= tx+reach;nx++)
+			{
+				if(nx < 0 || nx >= b->cols)
+					continue;
+				for(i = b->start[ny*b->cols+nx];i < b->start[ny*b->cols+nx+1];i++)
+				{
+					j = b->index[i];
+					color = demo_dots.color[j];
+					/* Dot's square, clipped to the tile */
+					x0 = (int)demo_dots.x[j]-(demo_dot_size-1)/2;
+					y0 = (int)demo_dots.y[j]-(demo_dot_size-1)/2;
+					x1 = x0+demo_dot_size;
+					y1 = y0+demo_dot_size;
+					x0 = x0 < left ? left : x0;
+					y0 = y0 < top ? top : y0;
+					x1 = x1 > right ? right : x1;
+					y1 = y1 > bottom ? bottom : y1;
+					if(x0 >= x1 || y0 >= y1)
+						continue;
+					fill += (x1-x0)*(y1-y0);
+					/* Set pixels */
+					for(y = y0;y < y1;y++)
+					{
+						row = demo_pixels+y*demo_rank;
+						if(demo_additive)
+							for(x = x0;x < x1;x++)
+								row[x] = demo_add_pixel(row[x],color);
+						else
+							for(x = x0;x < x1;x++)
+								row[x] = color;
+					}
+				}
+			}
 		}
-		if(demo_dots[i].y < 0.0f || demo_dots[i].y >= RES_Yf)
+	}
+	demo_tile_fill[worker][0] += fill;
+}
+
+/* Copy dots out in grid order */
+void demo_gather(int worker,int first,int last)
+{
+	int k,i;
+	for(k = first;k < last;k++)
+	{
+		i = demo_grid.index[k];
+		demo_sx[k] = demo_dots.x[i];
+		demo_sy[k] = demo_dots.y[i];
+		demo_svx[k] = demo_dots.vx[i]*demo_cool;
+		demo_svy[k] = demo_dots.vy[i]*demo_cool;
+	}
+}
+
+/*
+	Work out new speeds for the dots in grid buckets [first,last) from everything nearby. Only
+	the 3x3 cells around a dot can be in range; each bucket they hash to is searched once, and
+	anything else that shares it is too far away to pass the range check. Reads the current
+	speeds and writes the new ones elsewhere, so it doesn't matter which worker gets to a pair first.
+*/
+void demo_collide(int worker,int first,int last)
+{
+	int c,cell,cx,cy,nx,ny,k,m,q,near;
+	Uint32 n,seen[9];
+	float dx,dy,d2,dvn,ax,ay,vx,vy,speed;
+	double heat_in = 0.0,heat_out = 0.0;
+	float touch2 = 4.0f*demo_radius*demo_radius;
+	float range2 = demo_range*demo_range;
+	bins *b = &demo_grid;
+	int shared = b->mask != 0xffffffff; /* Otherwise each bucket is just the cell with its number */
+	int wrap = shared && b->buckets <= 2*b->cols+2; /* Only then can two cells around a dot share a bucket */
+	for(c = first;c < last;c++)
+	{
+		cx = c%b->cols;
+		cy = c/b->cols;
+		for(k = b->start[c];k < b->start[c+1];k++)
 		{
-			/* Undo move (demo_time_step is still the same value it was before and is valid for the current frame) */
-			demo_dots[i].y -= demo_dots[i].vy*demo_time_step;
-			/* Reverse */
-			demo_dots[i].vy = -demo_dots[i].vy;
+			if(shared)
+			{
+				cell = demo_bin_cell(b,demo_sx[k],demo_sy[k]);
+				cx = cell%b->cols;
+				cy = cell/b->cols;
+			}
+			ax = ay = 0.0f;
+			near = 0;
+			for(ny = cy-1;ny <= cy+1;ny++)
+			{
+				if(ny < 0 || ny >= b->rows)
+					continue;
+				for(nx = cx-1;nx <= cx+1;nx++)
+				{
+					if(nx < 0 || nx >= b->cols)
+						continue;
+					n = (ny*b->cols+nx)&b->mask;
+					if(wrap)
+					{
+						/* Search each bucket once */
+						for(q = 0;q < near && seen[q] != n;q++)
+							;
+						if(q < near)
+							continue;
+						seen[near++] = n;
+					}
+					for(m = b->start[n];m < b->start[n+1];m++)
+					{
+						dx = demo_sx[m]-demo_sx[k];
+						dy = demo_sy[m]-demo_sy[k];
+						d2 = dx*dx+dy*dy;
+						if(d2 >= range2 || d2 == 0.0f) /* Also skips itself */
+							continue;
+						if(d2 < touch2)
+						{
+							/* Touching: if closing in, swap speed along the line between them (equal masses, elastic) */
+							dvn = (demo_svx[m]-demo_svx[k])*dx+(demo_svy[m]-demo_svy[k])*dy;
+							if(dvn < 0.0f)
+							{
+								ax += dvn/d2*dx;
+								ay += dvn/d2*dy;
+							}
+						}
+						else if(demo_attract != 0.0f)
+						{
+							/* Close: pull together */
+							ax += demo_attract*demo_time_step*dx/sqrtf(d2);
+							ay += demo_attract*demo_time_step*dy/sqrtf(d2);
+						}
+					}
+				}
+			}
+			vx = demo_svx[k]+ax;
+			vy = demo_svy[k]+ay;
+			speed = vx*vx+vy*vy;
+			if(speed > MAX_SPEED*MAX_SPEED)
+			{
+				speed = MAX_SPEED/sqrtf(speed);
+				vx *= speed;
+				vy *= speed;
+			}
+			/* Keep track of energy going into and out of interactions, for demo_cool */
+			heat_in += demo_svx[k]*demo_svx[k]+demo_svy[k]*demo_svy[k];
+			heat_out += vx*vx+vy*vy;
+			demo_nvx[b->index[k]] = vx;
+			demo_nvy[b->index[k]] = vy;
 		}
 	}
+	demo_heat[worker][0] += heat_in;
+	demo_heat[worker][1] += heat_out;
+}
+
+/* Free bins */
+void demo_bins_free(bins *b)
+{
+	free(b->start);
+	free(b->count);
+	free(b->cell);
+	free(b->staged);
+	free(b->index);
+	memset(b,0,sizeof(bins));
+}
+
+/* Free dots */
+void demo_free()
+{
+	free(demo_dots.x);
+	free(demo_dots.y);
+	free(demo_dots.vx);
+	free(demo_dots.vy);
+	free(demo_dots.color);
+	free(demo_nvx);
+	free(demo_nvy);
+	free(demo_sx);
+	free(demo_sy);
+	free(demo_svx);
+	free(demo_svy);
+	memset(&demo_dots,0,sizeof(dots));
+	demo_nvx = demo_nvy = NULL;
+	demo_sx = demo_sy = demo_svx = demo_svy = NULL;
+	demo_bins_free(&demo_tiles);
+	demo_bins_free(&demo_grid);
+}
+
+/* Initialize dots */
+void demo_init(int count)
+{
+	int i;
+	/* Allocate */
+	demo_dots.count = count;
+	demo_dots.padded = (count+DOT_ALIGN-1)/DOT_ALIGN*DOT_ALIGN;
+	demo_dots.x = demo_array(demo_dots.padded,sizeof(float));
+	demo_dots.y = demo_array(demo_dots.padded,sizeof(float));
+	demo_dots.vx = demo_array(demo_dots.padded,sizeof(float));
+	demo_dots.vy = demo_array(demo_dots.padded,sizeof(float));
+	demo_dots.color = demo_array(demo_dots.padded,sizeof(Uint32));
+	/* Scatter; padding dots sit still at (0,0) and are never drawn */
+	for(i = 0;i < count;i++)
+	{
+		demo_dots.color[i] = SDL_MapRGBA(demo_screen->format,rand()%255,rand()%255,0,255);
+		demo_dots.vx[i] = demo_roll()*16.0f-8.0f;
+		demo_dots.vy[i] = demo_roll()*16.0f-8.0f;
+		demo_dots.x[i] = demo_roll()*RES_Xf;
+		demo_dots.y[i] = demo_roll()*RES_Yf;
+	}
+	/* Screen tiles */
+	demo_bins_init(&demo_tiles,TILE_SIZE,demo_screen->w,demo_screen->h,demo_dots.padded,0);
+	/* Interaction grid */
+	if(demo_interact)
+	{
+		demo_nvx = demo_array(demo_dots.padded,sizeof(float));
+		demo_nvy = demo_array(demo_dots.padded,sizeof(float));
+		demo_sx = demo_array(demo_dots.padded,sizeof(float));
+		demo_sy = demo_array(demo_dots.padded,sizeof(float));
+		demo_svx = demo_array(demo_dots.padded,sizeof(float));
+		demo_svy = demo_array(demo_dots.padded,sizeof(float));
+		demo_range = (demo_attract != 0.0f ? 4.0f : 2.0f)*demo_radius;
+		/* Fresh dots owe nothing to the last set's interactions */
+		demo_cool = 1.0f;
+		memset(demo_heat,0,sizeof(demo_heat));
+		demo_bins_init(&demo_grid,(int)ceilf(demo_range),RES_X,RES_Y,demo_dots.padded,1);
+	}
+	/* Pick the widest vector unit this CPU has */
+	demo_move = demo_move_scalar;
+	demo_move_name = "scalar";
+#ifdef DEMO_X86
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx"))
+	{
+		demo_move = demo_move_avx;
+		demo_move_name = "avx";
+	}
+	else if(__builtin_cpu_supports("sse2"))
+	{
+		demo_move = demo_move_sse2;
+		demo_move_name = "sse2";
+	}
+#endif
+}
+
+/* Handle dots */
+void demo_handle()
+{
+	int i;
+	float *swap;
+	double heat_in,heat_out;
+	double start = demo_seconds();
+	/* Interact */
+	if(demo_interact)
+	{
+		demo_bin(&demo_grid);
+		demo_parallel(demo_gather,demo_dots.count);
+		demo_parallel(demo_collide,demo_grid.buckets);
+		/*
+			Pushes from everything a dot hits at once are added up, which in a crowd can come to
+			more (or less) than there was to begin with; left alone, crowds heat up until they hit
+			MAX_SPEED, or freeze. Put energy back where it was, across the board, next step
+		*/
+		heat_in = heat_out = 0.0;
+		for(i = 0;i < demo_threads;i++)
+		{
+			heat_in += demo_heat[i][0];
+			heat_out += demo_heat[i][1];
+			demo_heat[i][0] = demo_heat[i][1] = 0.0;
+		}
+		demo_cool = heat_out > 0.0 ? (float)sqrt(heat_in/heat_out) : 1.0f;
+		swap = demo_dots.vx;
+		demo_dots.vx = demo_nvx;
+		demo_nvx = swap;
+		swap = demo_dots.vy;
+		demo_dots.vy = demo_nvy;
+		demo_nvy = swap;
+	}
+	/* Move */
+	demo_parallel(demo_move,demo_dots.padded);
+	demo_stat_update += demo_seconds()-start;
+	demo_stat_dots += demo_dots.count;
+	demo_stat_steps += 1.0;
 }
 
 /* Draw dots */
 void demo_draw()
 {
-	int i,rank,x,y;
-	Uint32 *pixel;
+	int i;
+	double start = demo_seconds();
+	/* Sort dots by screen tile, so each tile's writes stay in cache */
+	demo_bin(&demo_tiles);
 	/* Lock surface */
 	SDL_LockSurface(demo_screen);
-	rank = demo_screen->pitch/sizeof(Uint32);
-	pixel = (Uint32*)demo_screen->pixels;
-	/* Draw all dots */
-	for(i = 0;i < NUM_DOTS;i++)
-	{
-		/* Rasterize position as integer */
-		x = (int)demo_dots[i].x;
-		y = (int)demo_dots[i].y;
-		/* Set pixel */
-		pixel[x+y*rank] = SDL_MapRGBA(demo_screen->format,demo_dots[i].red,demo_dots[i].green,0,255);
-	}
+	demo_rank = demo_screen->pitch/sizeof(Uint32);
+	demo_pixels = (Uint32*)demo_screen->pixels;
+	/* Draw all tiles */
+	demo_parallel(demo_raster,demo_tiles.cols*demo_tiles.rows);
 	/* Unlock surface */
 	SDL_UnlockSurface(demo_screen);
+	demo_stat_draw += demo_seconds()-start;
+	for(i = 0;i < demo_threads;i++)
+	{
+		demo_stat_fill += demo_tile_fill[i][0];
+		demo_tile_fill[i][0] = 0.0;
+	}
 }
 
-/* Convert from timespec to float */
-float demo_convert_time(struct timespec *ts)
+/* Report throughput about once a second */
+void demo_report()
 {
-	float accu;
-	/* Combine the value into floating number */
-	accu = (float)ts->tv_sec; /* Seconds that have gone by */
-	accu *= 1000000000.0f; /* One second is 1000x1000x1000 nanoseconds, s -> ms, us, ns */
-	accu += (float)ts->tv_nsec; /* Nanoseconds that have gone by */
-	/* Bring it back into the millisecond range but keep the nanosecond resolution */
-	accu /= 1000000.0f;
-	return accu;
+	static double last = 0.0;
+	double now = demo_seconds();
+	if(last == 0.0)
+		last = now;
+	if(now-last < 1.0 || demo_stat_update <= 0.0 || demo_stat_draw <= 0.0)
+		return;
+	fprintf(stderr,"%i dots, %i threads, %s: %.2f ms/step, %.1f M particles/s, fill %.1f M pixels/s\n",
+		demo_dots.count,demo_threads,demo_move_name,demo_stat_update/demo_stat_steps*1000.0,
+		demo_stat_dots/demo_stat_update/1000000.0,demo_stat_fill/demo_stat_draw/1000000.0);
+	demo_stat_dots = demo_stat_update = demo_stat_steps = 0.0;
+	demo_stat_fill = demo_stat_draw = 0.0;
+	last = now;
 }
 
 /* Start time */
 void demo_start_time()
 {
-	struct timespec ts;
-	clock_gettime(CLOCK_PROCESS_CPUTIME_ID,&ts);
-	demo_time_measure = demo_convert_time(&ts);
+	demo_time_measure = demo_seconds()*1000.0;
 }
 
 /* End time */
 void demo_end_time()
 {
-	struct timespec ts;
 	float delta;
-	clock_gettime(CLOCK_PROCESS_CPUTIME_ID,&ts);
-	delta = demo_convert_time(&ts)-demo_time_measure; /* Find the distance in time */
+	delta = (float)(demo_seconds()*1000.0-demo_time_measure); /* Find the distance in time */
 	demo_time_step = delta/(1000.0f/16.0f); /* Weird formula, equals 1.0f at 16 frames a second */
 }
 
+/* Time simulation steps at a few sizes, without a window; for stress and thermal testing */
+int demo_bench()
+{
+	int sizes[] = {10000,100000,1000000};
+	int i,j;
+	double start,step,slowest;
+	/* Draw off screen so fill rate is measured too */
+	demo_screen = SDL_CreateRGBSurface(SDL_SWSURFACE,RES_X,RES_Y,32,0x00ff0000,0x0000ff00,0x000000ff,0xff000000);
+	if(!demo_screen)
+	{
+		fprintf(stderr,"Could not create surface: %s\n",SDL_GetError());
+		return 1;
+	}
+	demo_pool_init();
+	demo_time_step = 1.0f;
+	for(i = 0;i < (int)(sizeof(sizes)/sizeof(sizes[0]));i++)
+	{
+		demo_init(sizes[i]);
+		slowest = 0.0;
+		demo_stat_dots = demo_stat_update = demo_stat_steps = 0.0;
+		demo_stat_fill = demo_stat_draw = 0.0;
+		for(j = 0;j < BENCH_STEPS;j++)
+		{
+			start = demo_seconds();
+			demo_handle();
+			step = demo_seconds()-start;
+			slowest = step > slowest ? step : slowest;
+			demo_draw();
+		}
+		fprintf(stderr,"%8i dots, %i threads, %s%s: %.2f ms/step (slowest %.2f ms), %.1f M particles/s, fill %.1f M pixels/s\n",
+			sizes[i],demo_threads,demo_move_name,demo_interact ? "+interact" : "",
+			demo_stat_update/demo_stat_steps*1000.0,slowest*1000.0,
+			demo_stat_dots/demo_stat_update/1000000.0,demo_stat_fill/demo_stat_draw/1000000.0);
+		demo_free();
+	}
+	demo_pool_quit();
+	SDL_FreeSurface(demo_screen);
+	return 0;
+}
+
 /* Main */
 int main(int argn,char **argv)
 {
 	SDL_Event ev;
-	int active;
+	int active,opt,count,bench;
+	/* Parse options */
+	count = DEFAULT_DOTS;
+	bench = 0;
+	demo_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	while((opt = getopt(argn,argv,"n:t:s:air:g:b")) != -1)
+	{
+		switch(opt)
+		{
+		case 'n': /* How many dots */
+			count = atoi(optarg);
+			break;
+		case 't': /* How many threads */
+			demo_threads = atoi(optarg);
+			break;
+		case 's': /* How big a dot is, in pixels */
+			demo_dot_size = atoi(optarg);
+			break;
+		case 'a': /* Add dots onto the screen instead of overwriting */
+			demo_additive = 1;
+			break;
+		case 'i': /* Dots bump into each other */
+			demo_interact = 1;
+			break;
+		case 'r': /* Collision radius */
+			demo_radius = atof(optarg);
+			break;
+		case 'g': /* Attraction; implies -i */
+			demo_attract = atof(optarg);
+			demo_interact = 1;
+			break;
+		case 'b': /* Benchmark; implies -i */
+			bench = 1;
+			demo_interact = 1;
+			break;
+		default:
+			fprintf(stderr,"Usage: %s [-n dots] [-t threads] [-s dot size] [-a] [-i] [-r radius] [-g attraction] [-b]\n",argv[0]);
+			return 1;
+		}
+	}
+	if(count < 1)
+		count = 1;
+	if(demo_threads < 1)
+		demo_threads = 1;
+	if(demo_threads > MAX_THREADS)
+		demo_threads = MAX_THREADS;
+	if(demo_dot_size < 1)
+		demo_dot_size = 1;
+	if(demo_dot_size > TILE_SIZE)
+		demo_dot_size = TILE_SIZE;
+	if(demo_radius < 0.5f)
+		demo_radius = 0.5f;
+	if(bench)
+		return demo_bench();
 	/* Initialize SDL */
 	if(SDL_Init(SDL_INIT_VIDEO) != 0)
 		fprintf(stderr,"Could not initialize SDL: %s\n",SDL_GetError());
@@ -149,7 +870,8 @@ int main(int argn,char **argv)
 	if(!demo_screen)
 		fprintf(stderr,"Could not set video mode: %s\n",SDL_GetError());
 	/* Initialize game */
-	demo_init();
+	demo_init(count);
+	demo_pool_init();
 	/* Main loop */
 	active = 1;
 	while(active)
@@ -172,8 +894,12 @@ int main(int argn,char **argv)
 		SDL_Flip(demo_screen);
 		/* End time */
 		demo_end_time();
+		/* Show how fast we're going */
+		demo_report();
 	}
 	/* Exit */
+	demo_pool_quit();
+	demo_free();
 	SDL_Quit();
 	return 0;
 }